@@ -7,6 +7,9 @@
 
 #include "SMTransform.h"
 
+#include <map>
+#include <set>
+
 namespace SymbolicMath
 {
 
@@ -35,11 +38,22 @@ public:
   void operator()(Node<T> &, ConditionalData<T> &) override;
   void operator()(Node<T> &, IntegerPowerData<T> &) override;
 
-  std::string operator()() const { return _prologue + "return " + _source; };
+  /// function body evaluating the expression at the variable values pointed to by p (keeping
+  /// addresses out of the source makes it reusable across processes)
+  std::string operator()() const;
+
+  /// loop body evaluating the expression at n points read from input columns c into out
+  std::string batch() const;
+
+  /// variables in the order their columns are expected by the batch loop
+  const std::vector<const T *> & variables() const { return _vars; }
 
-  const std::string typeName();
+  static const std::string typeName();
 
 protected:
+  /// generate the source for a child node (shared subtrees are assigned to a temporary)
+  void visit(Node<T> & node);
+
   std::string bracket(std::string sub, short sub_precedence, short precedence);
 
   std::string _prologue;
@@ -48,6 +62,10 @@ protected:
   std::vector<const T *> _vars;
 
   unsigned int _tmp_id;
+
+  /// shared subtrees and the temporaries holding their values (and those of local variables)
+  std::set<const NodeData<T> *> _shared;
+  std::map<const NodeData<T> *, std::string> _temporaries;
 };
 
 } // namespace SymbolicMath
@@ -8,9 +8,21 @@
 #include "SMTransform.h"
 #include "SMEvaluable.h"
 
+#include <map>
+#include <set>
+#include <string>
+
+// threaded dispatch requires the labels as values extension
+#if defined(__GNUC__) || defined(__clang__)
+#define SYMBOLICMATH_THREADED_DISPATCH
+#endif
+
 namespace SymbolicMath
 {
 
+template <typename T>
+class CompiledCopyPatch;
+
 /**
  * Stack based bytecode machine translation and evaluation
  */
@@ -20,7 +32,7 @@ class CompiledByteCode : public Transform<T>, public Evaluable<T>
   using Transform<T>::apply;
 
 public:
-  CompiledByteCode(Function<T> &);
+  CompiledByteCode(Function<T> &, bool peephole = true);
 
   void operator()(Node<T> &, SymbolData<T> &) override;
 
@@ -39,11 +51,108 @@ public:
   void operator()(Node<T> &, ConditionalData<T> &) override;
   void operator()(Node<T> &, IntegerPowerData<T> &) override;
 
+  /**
+   * Mutable execution state (stacks and variable values). The compiled program is immutable, so
+   * a single CompiledByteCode object can be evaluated concurrently from multiple threads, each
+   * using its own Context obtained from context().
+   */
+  class Context
+  {
+  public:
+    Context() = default;
+
+  protected:
+    std::vector<T> _stack;
+    std::vector<T> _vals;
+
+    /// lane block execution stack, conditional masks, and pending branch blend targets
+    std::vector<T> _block_stack;
+    std::vector<T> _block_masks;
+    std::vector<int> _block_pending;
+
+    /// values of shared subexpressions (point by point and lane block)
+    std::vector<T> _slots;
+    std::vector<T> _block_slots;
+
+    friend class CompiledByteCode<T>;
+  };
+
+  /// build an execution context sized for this program
+  Context context() const;
+
+  /// evaluate using the internal context (not thread safe)
   T operator()() override;
+  void evaluate(const BatchColumns<T> & columns, T * output, std::size_t n) override;
+
+  /// evaluate using a caller supplied context (thread safe for distinct contexts)
+  T operator()(Context & context) const;
+  void evaluate(Context & context,
+                const BatchColumns<T> & columns,
+                T * output,
+                std::size_t n) const;
+
+  /**
+   * Set the number of points per lane block for batched evaluation. Each stack slot then holds a
+   * block of points and every dispatched instruction loops over the whole block. A size of 0
+   * evaluates batches one point at a time.
+   */
+  void setLaneBlockSize(std::size_t lanes) { _lanes = lanes; }
+  std::size_t laneBlockSize() const { return _lanes; }
+
+  /// instruction dispatch used for point by point evaluation
+  enum class Dispatch
+  {
+    SWITCH,
+    THREADED
+  };
+
+  /// select the dispatch mode (THREADED falls back to SWITCH where unsupported)
+  void setDispatch(Dispatch dispatch);
+  Dispatch dispatch() const { return _dispatch; }
 
   void print();
 
+  /// count consecutive instruction pairs in the byte code (used to pick superinstructions)
+  std::map<std::pair<std::string, std::string>, std::size_t> opcodePairHistogram() const;
+
+  /// mnemonic of a byte code instruction
+  static const std::string & instructionName(int instruction);
+
 protected:
+  /// run the byte code on the current variable values in context
+  T execute(Context & context) const;
+
+  /// switch based interpreter
+  T executeSwitch(Context & context) const;
+
+#ifdef SYMBOLICMATH_THREADED_DISPATCH
+  /// threaded interpreter (if labels is non-null only the handler table is returned)
+  T executeThreaded(Context & context, const void * const ** labels) const;
+#endif
+
+  /// run the byte code on m points (lane block) starting at point start of the input columns
+  void executeBlock(Context & context,
+                    const std::vector<const T *> & input,
+                    std::size_t start,
+                    std::size_t m,
+                    T * output) const;
+
+  /// apply f to each lane of the block a
+  template <typename F>
+  static void laneUnary(T * a, std::size_t m, F f)
+  {
+    for (std::size_t i = 0; i < m; ++i)
+      a[i] = f(a[i]);
+  }
+
+  /// apply f lane by lane to the blocks a and b, storing the result in a
+  template <typename F>
+  static void laneBinary(T * a, const T * b, std::size_t m, F f)
+  {
+    for (std::size_t i = 0; i < m; ++i)
+      a[i] = f(a[i], b[i]);
+  }
+
   enum class VMInstruction : int
   {
     LOAD_IMMEDIATE_INTEGER = 0,
@@ -132,14 +241,49 @@ protected:
     ADD3,
 
     FETCH,
-    FETCH0
+    FETCH0,
+
+    // shared subexpression slots
+    STORE_SLOT,
+    LOAD_SLOT,
+
+    // superinstructions generated by the peephole optimizer
+    MUL_IMMEDIATE,
+    ADD_IMMEDIATE,
+    DIV_IMMEDIATE,
+    SUB_VARIABLE,
+    MUL_VARIABLE,
+    MUL_ADD,
+
+    // end of the threaded code (never emitted into the byte code, must stay last)
+    RETURN
   };
 
+  /// emit the byte code for a child node (shared subtrees are computed once and stored in a slot)
+  void visit(Node<T> & node);
+
+  /// does the instruction take an operand from the byte code
+  static bool hasOperand(VMInstruction instruction);
+
+  /// fuse common instruction sequences into superinstructions (returns true if code changed)
+  bool peephole();
+
   /// byte code data
   std::vector<int> _byte_code;
 
-  /// execution stack (not thread safe)
-  std::vector<T> _stack;
+  /// byte code resolved to handler addresses (operands are kept in place)
+  union ThreadedCode
+  {
+    const void * _handler;
+    int _operand;
+  };
+  std::vector<ThreadedCode> _threaded_code;
+
+  /// selected dispatch mode
+  Dispatch _dispatch;
+
+  /// required execution stack size
+  std::size_t _stack_depth;
 
   /// immediates
   std::vector<T> _immed;
@@ -147,7 +291,27 @@ protected:
   /// variables
   std::size_t _nvars;
   std::vector<const T *> _vars;
-  std::vector<T> _vals;
+
+  /// shared subtrees of the function, and the slots holding the ones already computed at the
+  /// current point of code generation
+  std::set<const NodeData<T> *> _shared;
+  std::map<const NodeData<T> *, int> _slot_index;
+  std::size_t _nslots;
+
+  /// slots holding the values of the assigned local variables
+  std::map<const NodeData<T> *, int> _local_slot_index;
+
+  /// number of conditionals in the byte code (bounds the extra lane block stack depth)
+  std::size_t _nconditionals;
+
+  /// points per lane block
+  std::size_t _lanes;
+
+  /// execution context used by the Evaluable interface
+  Context _context;
+
+  /// translates the byte code to machine code
+  friend class CompiledCopyPatch<T>;
 };
 
 } // namespace SymbolicMath
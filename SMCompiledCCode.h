@@ -9,6 +9,7 @@
 
 #include "SMEvaluable.h"
 #include "SMFunction.h"
+#include "SMDiskCache.h"
 
 namespace SymbolicMath
 {
@@ -22,14 +23,30 @@ class CompiledCCode : public Evaluable<T>
 public:
   CompiledCCode(Function<T> &);
 
-  T operator()() override { return _jit_function(); }
+  T operator()() override { return _jit_function(_vars.data()); }
+  void evaluate(const BatchColumns<T> & columns, T * output, std::size_t n) override;
 
 protected:
   const std::string typeHeader();
 
-  typedef Real (*JITFunctionPtr)();
+  /// compile ccode into the shared object file object
+  void build(const std::string & ccode, const std::string & object);
+
+  /// load the shared object from the cache or build and store it (nullptr if the cache failed)
+  void * loadCached(DiskCache & cache, const std::string & ccode);
+
+  /// compiler version string (part of the cache key)
+  static const std::string & compilerVersion();
+
+  typedef Real (*JITFunctionPtr)(const Real * const *);
+  typedef void (*JITBatchFunctionPtr)(const Real * const *, Real *, unsigned long);
 
   JITFunctionPtr _jit_function;
+  JITBatchFunctionPtr _jit_batch_function;
+
+  /// variables in the order the function expects their addresses and the batch function its
+  /// input columns
+  std::vector<const T *> _vars;
 };
 
 } // namespace SymbolicMath
@@ -0,0 +1,88 @@
+///
+/// SymbolicMath toolkit
+/// (c) 2017-2020 by Daniel Schwen
+///
+
+#pragma once
+
+#include "SMCompiledByteCode.h"
+
+#include <cstdint>
+#include <map>
+#include <vector>
+
+namespace SymbolicMath
+{
+
+/**
+ * Copy-and-patch compiler. The function is translated to byte code first, then every byte code
+ * instruction is replaced by a stencil, a hand-encoded x86-64 byte template in the
+ * implementation file, with the holes for immediates, variable addresses, stack offsets, helper
+ * function addresses, and jump targets patched in. No instruction selection or register
+ * allocation happens at run time, so compilation costs little more than the byte code
+ * generation. The top of the stack is kept in xmm0, the remaining stack entries and the shared
+ * subexpression slots live in the native stack frame. Only available on x86-64 System V
+ * platforms.
+ *
+ * Arithmetic, comparisons, logical operators, abs, sqrt, integer powers, shared subexpression
+ * slots, and conditionals are emitted inline. All other operations call a C++ helper function:
+ * acos, acosh, asin, asinh, atan, atanh, cbrt, ceil, cos, cosh, cot, csc, erf, erfc, exp, exp2,
+ * floor, int, log, log10, log2, sec, sin, sinh, tan, tanh, and trunc (unary), as well as
+ * modulo, power, pow, atan2, hypot, max, min, and plog (binary).
+ */
+template <typename T>
+class CompiledCopyPatch : public Evaluable<T>
+{
+public:
+  CompiledCopyPatch(Function<T> &);
+  ~CompiledCopyPatch() override;
+
+  T operator()() override { return _jit_function(); }
+
+protected:
+  using VMInstruction = typename CompiledByteCode<T>::VMInstruction;
+
+  /// append a stencil
+  void copy(std::initializer_list<uint8_t> stencil);
+
+  ///@{ patch the hole at the end of the code
+  void patch32(int32_t value);
+  void patch64(uint64_t value);
+  ///@}
+
+  ///@{ stencils with holes
+  void loadImmediate(uint8_t xmm, uint64_t bits);
+  void loadAddress(const void * address);
+  void frameAccess(std::initializer_list<uint8_t> opcode, uint8_t xmm, int entry);
+  void callHelper(const void * function);
+  void binaryHelper(const void * function);
+  ///@}
+
+  /// store the top of stack to make room for a push
+  void spill();
+
+  /// bit pattern of a value
+  static uint64_t bits(T value);
+
+  /// number of entries on the stack while translating
+  int _depth;
+
+  /// offset of the first slot (slots follow the stack entries in the frame)
+  int _slot_base;
+
+  /// machine code and the code offset of each byte code instruction
+  std::vector<uint8_t> _code;
+  std::vector<std::size_t> _offset;
+
+  /// rel32 holes and the byte code instruction they jump to
+  std::vector<std::pair<std::size_t, int>> _jumps;
+
+  /// stack depth at jump targets
+  std::map<int, int> _target_depth;
+
+  typedef T (*JITFunctionPtr)();
+  JITFunctionPtr _jit_function;
+  std::size_t _code_size;
+};
+
+} // namespace SymbolicMath
@@ -7,8 +7,10 @@
 
 #include "SMTransform.h"
 #include "SMEvaluable.h"
+#include "SMDiskCache.h"
 
 #include <llvm/ExecutionEngine/ExecutionEngine.h>
+#include <llvm/ExecutionEngine/ObjectCache.h>
 #include <llvm/IR/IRBuilder.h>
 #include <llvm/IR/LLVMContext.h>
 #include <llvm/IR/Verifier.h>
@@ -19,12 +21,21 @@
 #include <llvm/ADT/StringRef.h>
 #include <llvm/ADT/Triple.h>
 #include <llvm/ExecutionEngine/JITSymbol.h>
+#include <llvm/ExecutionEngine/Orc/IRCompileLayer.h>
 #include <llvm/ExecutionEngine/Orc/LLJIT.h>
+#include <llvm/ExecutionEngine/Orc/RTDyldObjectLinkingLayer.h>
+#include <llvm/ExecutionEngine/Orc/ThreadSafeModule.h>
 #include <llvm/IR/DataLayout.h>
 #include <llvm/IR/Module.h>
 #include <llvm/Support/Error.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Target/TargetMachine.h>
 
+#include <map>
 #include <memory>
+#include <mutex>
+#include <set>
+#include <vector>
 
 namespace SymbolicMath
 {
@@ -58,39 +69,57 @@ public:
   void operator()(Node<T> &, ConditionalData<T> &) override;
   void operator()(Node<T> &, IntegerPowerData<T> &) override;
 
-  T operator()() override { return _jit_function(); }
+  T operator()() override { return _jit_function(_vars.data()); }
+  void evaluate(const BatchColumns<T> & columns, T * output, std::size_t n) override;
 
 protected:
-  class Helper;
-  std::unique_ptr<Helper> _lljit;
+  class Session;
 
-  enum class Native
-  {
-    acos,
-    acosh,
-    asin,
-    asinh,
-    atan,
-    atanh,
-    cbrt,
-    cosh,
-    cot,
-    csc,
-    erf,
-    erfc,
-    sec,
-    sinh,
-    tan,
-    tanh,
-    atan2,
-    plog
-  };
-  std::map<Native, llvm::Function *> _native;
+  /// exclusive use of a pooled context while the IR is built and compiled
+  class ContextLease;
+  std::unique_ptr<ContextLease> _context;
+
+  /// pooled dylib holding the machine code of this function (removed through its resource
+  /// tracker when the lease ends)
+  class DylibLease;
+  std::unique_ptr<DylibLease> _dylib;
+
+  typedef Real (*JITFunctionPtr)(const Real * const *);
+  typedef void (*JITBatchFunctionPtr)(const Real * const *, Real *, std::size_t);
+
+  /// emit IR for a child node (shared subtrees are computed once and their SSA value reused)
+  void visit(Node<T> & node);
 
-  typedef Real (*JITFunctionPtr)();
+  /// call an LLVM intrinsic on doubles (lowered to native instructions where the target has them)
+  llvm::Value * intrinsic(llvm::Intrinsic::ID id, llvm::ArrayRef<llvm::Value *> args);
+
+  /// call a double precision function of the C math library (declared on first use)
+  llvm::Value * libm(const std::string & name, llvm::ArrayRef<llvm::Value *> args);
+
+  /// 1.0 / value
+  llvm::Value * reciprocal(llvm::Value * value);
+
+  /// convert a comparison result to 0.0 or 1.0 without branching
+  llvm::Value * boolean(llvm::Value * condition);
 
   llvm::Value * _value;
 
+  /// shared subtrees (and local variables) and the values computed for them in the function
+  /// being emitted
+  std::set<const NodeData<T> *> _shared;
+  std::map<const NodeData<T> *, llvm::Value *> _shared_values;
+
+  /// variable address table while emitting the function (nullptr otherwise)
+  llvm::Value * _params;
+
+  /// input column table and point index while emitting the batch loop (nullptr otherwise)
+  llvm::Value * _batch_columns;
+  llvm::Value * _batch_index;
+
+  /// variables in the order the function expects their addresses and the batch function its
+  /// input columns
+  std::vector<const T *> _vars;
+
   struct JITStateValue
   {
     JITStateValue(llvm::BasicBlock * BB, llvm::Module * M_) : builder(BB), M(M_) {}
@@ -100,41 +129,120 @@ protected:
   std::unique_ptr<JITStateValue> _state;
 
   JITFunctionPtr _jit_function;
+  JITBatchFunctionPtr _jit_batch_function;
 };
 
+/**
+ * Process wide LLJIT session shared by all CompiledLLVM instances. Each compiled function lives in
+ * its own dylib (so every function can use the same symbol names, which keeps its IR and disk
+ * cache key independent of the instance) and is added through a resource tracker. Removing the
+ * tracker frees the machine code of the function, and the emptied dylib is reused by later
+ * functions. Modules are built in contexts from a pool so functions can be compiled on several
+ * threads at once.
+ */
 template <typename T>
-class CompiledLLVM<T>::Helper
+class CompiledLLVM<T>::Session
 {
 public:
-  Helper();
+  static Session & instance();
 
   // Not a value type.
-  Helper(const Helper &) = delete;
-  Helper & operator=(const Helper &) = delete;
-  Helper(Helper &&) = delete;
-  Helper & operator=(Helper &&) = delete;
+  Session(const Session &) = delete;
+  Session & operator=(const Session &) = delete;
+  Session(Session &&) = delete;
+  Session & operator=(Session &&) = delete;
 
   llvm::DataLayout getDataLayout() const { return _lljit->getDataLayout(); }
 
-  // const llvm::Triple & getTargetTriple() const { return TT; }
+  /// take an empty dylib from the pool (or create one)
+  llvm::orc::JITDylib & acquireDylib();
+
+  /// remove the machine code added through tracker and return its dylib to the pool
+  void releaseDylib(llvm::orc::ResourceTrackerSP tracker);
 
-  llvm::Error submitModule(std::unique_ptr<llvm::Module> M, std::unique_ptr<llvm::LLVMContext> C);
+  llvm::Error submitModule(llvm::orc::ResourceTrackerSP tracker, llvm::orc::ThreadSafeModule M);
+
+  /// add previously compiled machine code (from the disk cache)
+  llvm::Error addObjectFile(llvm::orc::ResourceTrackerSP tracker,
+                            std::unique_ptr<llvm::MemoryBuffer> O);
+
+  /// store the machine code of module M in the disk cache under key once it is compiled
+  void cacheObject(const llvm::Module * M, DiskCache * cache, const std::string & key);
 
   template <class Signature_t>
-  llvm::Expected<std::function<Signature_t>> getFunction(llvm::StringRef Name)
+  llvm::Expected<std::function<Signature_t>> getFunction(llvm::orc::JITDylib & dylib,
+                                                         llvm::StringRef Name)
   {
-    if (auto A = getFunctionAddr(Name))
+    if (auto A = getFunctionAddr(dylib, Name))
       return std::function<Signature_t>(llvm::jitTargetAddressToPointer<Signature_t *>(*A));
     else
       return A.takeError();
   }
 
-  llvm::Expected<llvm::JITTargetAddress> getFunctionAddr(llvm::StringRef Name);
+  llvm::Expected<llvm::JITTargetAddress> getFunctionAddr(llvm::orc::JITDylib & dylib,
+                                                         llvm::StringRef Name);
 
 private:
+  Session();
+
+  friend class CompiledLLVM<T>::ContextLease;
+
+  /// hands the compiled object of a module to the disk cache
+  class DiskObjectCache : public llvm::ObjectCache
+  {
+  public:
+    void notifyObjectCompiled(const llvm::Module * M, llvm::MemoryBufferRef object) override;
+    std::unique_ptr<llvm::MemoryBuffer> getObject(const llvm::Module *) override
+    {
+      return nullptr;
+    }
+
+    /// cache and key for each module waiting to be compiled
+    std::map<const llvm::Module *, std::pair<DiskCache *, std::string>> _pending;
+    std::mutex _mutex;
+  };
+
+  /// declared before the JIT, whose compile layer refers to it
+  DiskObjectCache _object_cache;
+
+  /// compiles (on the calling thread) and links all modules, the object linking layer frees the
+  /// memory of the objects added through a resource tracker when the tracker is removed
   std::unique_ptr<llvm::orc::LLJIT> _lljit;
 
-  llvm::orc::JITDylib::GeneratorFunction createHostProcessResolver(llvm::DataLayout DL);
+  /// dylibs and contexts not in use by any function (guarded by _mutex)
+  std::vector<llvm::orc::JITDylib *> _free_dylibs;
+  std::vector<llvm::orc::ThreadSafeContext> _free_contexts;
+  std::size_t _dylib_count;
+  std::mutex _mutex;
+};
+
+template <typename T>
+class CompiledLLVM<T>::ContextLease
+{
+public:
+  ContextLease(Session & session);
+  ~ContextLease();
+
+  llvm::orc::ThreadSafeContext & get() { return _context; }
+
+private:
+  Session & _session;
+  llvm::orc::ThreadSafeContext _context;
+};
+
+template <typename T>
+class CompiledLLVM<T>::DylibLease
+{
+public:
+  DylibLease(Session & session);
+  ~DylibLease();
+
+  llvm::orc::JITDylib & dylib() { return _tracker->getJITDylib(); }
+  llvm::orc::ResourceTrackerSP tracker() { return _tracker; }
+
+private:
+  Session & _session;
+  llvm::orc::ResourceTrackerSP _tracker;
 };
 
 } // namespace SymbolicMath
@@ -0,0 +1,151 @@
+///
+/// SymbolicMath toolkit
+/// (c) 2017-2020 by Daniel Schwen
+///
+
+#pragma once
+
+#include "SMTransform.h"
+#include "SMEvaluable.h"
+
+#include <map>
+
+namespace SymbolicMath
+{
+
+/**
+ * Register based bytecode machine translation and evaluation. The expression tree is compiled
+ * into three-address instructions operating on virtual registers, which are then mapped onto a
+ * compact register file using linear scan allocation. Variables and constants live in fixed
+ * registers and are used as operands directly.
+ */
+template <typename T>
+class CompiledRegisterCode : public Transform<T>, public Evaluable<T>
+{
+  using Transform<T>::apply;
+
+public:
+  CompiledRegisterCode(Function<T> &);
+
+  void operator()(Node<T> &, SymbolData<T> &) override;
+
+  void operator()(Node<T> &, UnaryOperatorData<T> &) override;
+  void operator()(Node<T> &, BinaryOperatorData<T> &) override;
+  void operator()(Node<T> &, MultinaryOperatorData<T> &) override;
+
+  void operator()(Node<T> &, UnaryFunctionData<T> &) override;
+  void operator()(Node<T> &, BinaryFunctionData<T> &) override;
+
+  void operator()(Node<T> &, RealNumberData<T> &) override;
+  void operator()(Node<T> &, RealReferenceData<T> &) override;
+  void operator()(Node<T> &, RealArrayReferenceData<T> &) override;
+  void operator()(Node<T> &, LocalVariableData<T> &) override;
+
+  void operator()(Node<T> &, ConditionalData<T> &) override;
+  void operator()(Node<T> &, IntegerPowerData<T> &) override;
+
+  T operator()() override;
+  void evaluate(const BatchColumns<T> & columns, T * output, std::size_t n) override;
+
+  void print();
+
+  /// number of registers after allocation (variables, constants, and temporaries)
+  std::size_t registerCount() const { return _registers.size(); }
+
+protected:
+  enum class RegisterOp
+  {
+    MOV,
+    NEG,
+    ADD,
+    SUB,
+    MUL,
+    DIV,
+    SQR,
+    POWI,
+    LESS_THAN,
+    GREATER_THAN,
+    LESS_EQUAL,
+    GREATER_EQUAL,
+    EQUAL,
+    NOT_EQUAL,
+    LOGICAL_AND,
+    LOGICAL_OR,
+    MIN,
+    MAX,
+    CALL1,
+    CALL2,
+    JUMP_IF_ZERO,
+    JUMP
+  };
+
+  using UnaryFunctionPtr = T (*)(T);
+  using BinaryFunctionPtr = T (*)(T, T);
+
+  struct Instruction
+  {
+    RegisterOp _op;
+    int _dst;
+    int _a;
+    int _b;
+    union
+    {
+      /// jump target or integer exponent
+      int _immediate;
+      UnaryFunctionPtr _unary;
+      BinaryFunctionPtr _binary;
+    };
+  };
+
+  /// kind of a virtual register
+  enum class RegisterKind
+  {
+    VARIABLE,
+    CONSTANT,
+    TEMPORARY
+  };
+
+  /// evaluate a child node (reusing the register of an already evaluated shared subtree)
+  int emit(Node<T> & node);
+
+  /// create a new virtual register
+  int newRegister(RegisterKind kind, int index = 0);
+
+  /// append an instruction writing to a new temporary and make it the current result
+  void emitOp(RegisterOp op, int a, int b = -1);
+  void emitCall(UnaryFunctionPtr f, int a);
+  void emitCall(BinaryFunctionPtr f, int a, int b);
+
+  /// map virtual registers onto physical registers
+  void allocateRegisters();
+
+  /// run the program on the current register contents
+  T execute();
+
+  static T truncWrapper(T);
+  static T cot(T);
+  static T csc(T);
+  static T sec(T);
+  static T plog(T, T);
+
+  /// program
+  std::vector<Instruction> _code;
+
+  /// virtual register kinds and indices (variable or constant number)
+  std::vector<std::pair<RegisterKind, int>> _virtual;
+
+  /// register holding the current (sub)expression result during compilation
+  int _result;
+
+  /// registers holding the values of already compiled shared subtrees
+  std::map<const NodeData<T> *, int> _cache;
+
+  /// variables and constants (loaded into the first registers)
+  std::vector<const T *> _vars;
+  std::vector<T> _constants;
+
+  /// register file (not thread safe)
+  std::vector<T> _registers;
+};
+
+} // namespace SymbolicMath
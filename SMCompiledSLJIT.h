@@ -11,12 +11,17 @@
 #include "contrib/sljit/sljit_src/sljitLir.h"
 
 #include <list>
+#include <map>
+#include <set>
 
 namespace SymbolicMath
 {
 
 /**
- * SLJIT compiler transform
+ * SLJIT compiler transform. The bottom entries of the evaluation stack are kept in float
+ * registers (callee saved registers first, as they survive function calls, then the scratch
+ * registers not used as temporaries), deeper entries live in the stack frame. Operands are
+ * evaluated in Sethi-Ullman order to keep the stack shallow.
  */
 template <typename T>
 class CompiledSLJIT : public Transform<T>, public Evaluable<T>
@@ -45,31 +50,90 @@ public:
   void operator()(Node<T> &, IntegerPowerData<T> &) override;
 
   T operator()() override { return _jit_function(); }
+  void evaluate(const BatchColumns<T> & columns, T * output, std::size_t n) override;
 
 protected:
+  /// emit the scalar function or the batch loop over the expression
+  void * generate(bool batch, int stack_depth);
+
+  /// emit code for a child node (shared subtrees are computed once and kept in a spill slot)
+  void visit(Node<T> & node);
+
   void stackPush();
-  void stackPop(sljit_s32);
+  void stackPop();
+
+  ///@{ SLJIT operand holding stack entry i (a float register or its home slot in the frame)
+  sljit_s32 entry(int i) const;
+  sljit_sw entryw(int i) const;
+  ///@}
+
+  /// Sethi-Ullman number (stack entries needed to evaluate node)
+  int need(Node<T> node);
+
+  /// evaluate two operands, the one with the larger need first (returns true if b came first)
+  bool visitPair(Node<T> & a, Node<T> & b);
+
+  /// pop the two operands pushed by visitPair into FR0 (a) and FR1 (b)
+  void loadPair(bool swapped);
+
+  ///@{ store and reload the first live stack entries held in scratch registers around a call
+  void saveScratch(int live);
+  void restoreScratch(int live);
+  ///@}
 
   void unaryFunctionCall(T (*func)(T));
   void binaryFunctionCall(T (*func)(T, T));
 
   void emitFcmp(sljit_s32);
 
-  static T truncWrapper(T);
+  ///@{ inline native instructions for the current target (calls are the fallback)
+  static bool hasNative(UnaryFunctionType type);
+  void emitNative(UnaryFunctionType type, sljit_s32 reg);
+  void nativeFunction(UnaryFunctionType type, T (*func)(T));
+  bool emitMinMax(sljit_u8 opcode);
+  ///@}
+
+  static T hypot(T, T);
   static T plog(T, T);
 
   /// current stack entry (as array index)
   int _sp;
 
+  /// number of stack entries (the spill slots for shared subtrees follow the stack)
+  int _stack_depth;
+
+  /// float registers holding the bottom stack entries (the first _fsaveds are callee saved)
+  std::vector<sljit_s32> _registers;
+  int _fsaveds;
+  int _fscratches;
+
+  /// memoized Sethi-Ullman numbers
+  std::map<const NodeData<T> *, int> _need;
+
+  /// spill slot of each shared subtree, and the shared subtrees already computed at the current
+  /// point of code generation
+  std::map<const NodeData<T> *, int> _slot;
+  std::set<const NodeData<T> *> _stored;
+
   /// SLJIT compiler context
   struct sljit_compiler * _ctx;
 
   /// store immediates in a "pointer stable" way
   std::list<T> _immediate;
 
+  /// emitting the batch loop (variables are read from input columns)
+  bool _batch;
+
+  /// variables in the order the batch function expects its input columns
+  std::vector<const T *> _vars;
+
   /// compiled function (TODO: pass result by reference)
   using JITFunctionPtr = T SLJIT_FUNC (*)();
   JITFunctionPtr _jit_function;
+
+  /// compiled batch function (input columns, output, number of points)
+  using JITBatchFunctionPtr = void SLJIT_FUNC (*)(const T * const *, T *, sljit_uw);
+  JITBatchFunctionPtr _jit_batch_function;
 };
 
 } // namespace SymbolicMath
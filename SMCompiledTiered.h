@@ -0,0 +1,77 @@
+///
+/// SymbolicMath toolkit
+/// (c) 2017-2020 by Daniel Schwen
+///
+
+#pragma once
+
+#include "SMEvaluable.h"
+#include "SMFunction.h"
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+
+namespace SymbolicMath
+{
+
+/**
+ * Tiered compilation. Evaluation starts on the byte code interpreter right away. Once the function
+ * has been evaluated threshold times the target backend (the best registered compiler by default)
+ * is built on a background thread, and evaluation switches over to it as soon as it is ready.
+ * Callers never wait for the optimizing compiler. Destroying the object while the background
+ * compilation is running waits for it to finish (a compilation that has not started yet is
+ * skipped). The background thread compiles a private deep copy of the expression tree (heap
+ * allocated, without node table, and with its polynomials rewritten and dependencies computed on
+ * the calling thread), so the function and its arena remain free for use by the calling thread.
+ */
+template <typename T>
+class CompiledTiered : public Evaluable<T>
+{
+public:
+  CompiledTiered(Function<T> & fb, std::size_t threshold = 1000, const std::string & target = "");
+  ~CompiledTiered() override;
+
+  T operator()() override
+  {
+    if (_calls.fetch_add(1, std::memory_order_relaxed) == _threshold)
+      promote();
+    return (*_active.load(std::memory_order_acquire))();
+  }
+
+  void evaluate(const BatchColumns<T> & columns, T * output, std::size_t n) override;
+
+  /// true once evaluation has switched to the target backend
+  bool ready() const { return _active.load(std::memory_order_acquire) != _interpreter.get(); }
+
+  /// name of the backend built in the background
+  const std::string & target() const { return _target; }
+
+protected:
+  /// start the background compilation (called once, when the function becomes hot)
+  void promote();
+
+  /// shallow copy of the compiled function (keeps the expression tree alive)
+  Function<T> _function;
+
+  /// deep copy of the function owned by the background compilation
+  std::unique_ptr<Function<T>> _copy;
+
+  /// number of evaluations before the target backend is built
+  const std::size_t _threshold;
+  std::string _target;
+
+  std::unique_ptr<Evaluable<T>> _interpreter;
+  std::unique_ptr<Evaluable<T>> _optimized;
+
+  /// backend used for evaluation (swapped once the target backend is ready)
+  std::atomic<Evaluable<T> *> _active;
+  std::atomic<std::size_t> _calls;
+
+  /// set by the destructor to skip a background compilation that has not started yet
+  std::atomic<bool> _cancelled;
+  std::thread _thread;
+};
+
+} // namespace SymbolicMath
@@ -6,12 +6,21 @@
 #pragma once
 
 #include "SMEvaluable.h"
+#include "SMFunction.h"
+#include "SMFlatIR.h"
+#include "SMDiskCache.h"
+#include "SMTransformPolynomial.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
 #include <memory>
 #include <vector>
 #include <utility>
 #include <string>
 #include <map>
+#include <set>
 #include <type_traits>
 #include <stdexcept>
 
@@ -39,18 +48,77 @@ public:
   // get the highest priority compiler that's registered
   static std::string bestCompiler();
 
-  // build compiler
+  // build compiler (rewriting polynomials in fb into the form selected for the compiler)
   static std::unique_ptr<Evaluable<T>> buildCompiler(const std::string & C_name, Function<T> & fb);
   static std::unique_ptr<Evaluable<T>> buildBestCompiler(Function<T> & fb);
 
+  // build compiler without rewriting polynomials (fb must already be in the selected form)
+  static std::unique_ptr<Evaluable<T>> constructCompiler(const std::string & C_name,
+                                                         Function<T> & fb);
+
+  /**
+   * build the compiler with the lowest total cost (compile time plus expected_calls evaluations)
+   * for fb, measured by compiling and benchmarking the registered backends at the current
+   * variable values. Backends are tried in order of increasing priority, and a backend is
+   * discarded without benchmarking once its compilation alone costs more than the best total so
+   * far (backends that previously compiled slower than that are skipped). Each candidate compiles
+   * an unmodified copy of fb, and only the selected backend rewrites fb itself. Decisions are
+   * remembered per expression (before and after that rewrite) and call count magnitude (and
+   * stored in the DiskCache, if enabled).
+   */
+  static std::unique_ptr<Evaluable<T>> buildTunedCompiler(Function<T> & fb,
+                                                          std::size_t expected_calls);
+
+  // select the polynomial evaluation form for a compiler (PolynomialForm::NONE by default)
+  static void setPolynomialForm(const std::string & C_name, PolynomialForm form);
+  static PolynomialForm polynomialForm(const std::string & C_name);
+
 protected:
-  // registered compilers
-  static std::map<std::string, std::pair<buildEvaluable<T>, int>> _compiler_registry;
+  // registered compilers (constructed on first use, as registration happens during static
+  // initialization of the compiler translation units)
+  static std::map<std::string, std::pair<buildEvaluable<T>, int>> & registry();
+
+  // polynomial evaluation forms selected per compiler
+  static std::map<std::string, PolynomialForm> & polynomialForms();
+
+  // compilers selected by buildTunedCompiler per tuning key
+  static std::map<std::string, std::string> & tunedCompilers();
+
+  // shortest compile time observed per compiler (used to skip hopeless candidates)
+  static std::map<std::string, double> & compileTimes();
 };
 
-// static member
 template <typename T>
-std::map<std::string, std::pair<buildEvaluable<T>, int>> CompilerFactory<T>::_compiler_registry;
+std::map<std::string, std::pair<buildEvaluable<T>, int>> &
+CompilerFactory<T>::registry()
+{
+  static std::map<std::string, std::pair<buildEvaluable<T>, int>> compiler_registry;
+  return compiler_registry;
+}
+
+template <typename T>
+std::map<std::string, PolynomialForm> &
+CompilerFactory<T>::polynomialForms()
+{
+  static std::map<std::string, PolynomialForm> forms;
+  return forms;
+}
+
+template <typename T>
+std::map<std::string, std::string> &
+CompilerFactory<T>::tunedCompilers()
+{
+  static std::map<std::string, std::string> tuned;
+  return tuned;
+}
+
+template <typename T>
+std::map<std::string, double> &
+CompilerFactory<T>::compileTimes()
+{
+  static std::map<std::string, double> times;
+  return times;
+}
 
 // registration macro
 #define CONCAT_IMPL(x, y) x##y
@@ -68,7 +136,7 @@ CompilerFactory<T>::registerCompilerInternal(const std::string & C_name)
   static_assert(priority > 0,
                 "A priority greater than zero is required for a registerCompiler directive.");
 
-  _compiler_registry.emplace(
+  registry().emplace(
       C_name,
       std::make_pair([](Function<T> & fb) { return std::make_unique<C<T>>(fb); }, priority));
   return true;
@@ -80,7 +148,7 @@ std::vector<std::string>
 CompilerFactory<T>::listCompilers()
 {
   std::vector<std::string> ret;
-  for (auto p : _compiler_registry)
+  for (auto p : registry())
     ret.push_back(p.first);
   return ret;
 }
@@ -92,7 +160,7 @@ CompilerFactory<T>::bestCompiler()
   std::string ret;
   int pmax = 0;
 
-  for (auto p : _compiler_registry)
+  for (auto p : registry())
     if (p.second.second > pmax)
     {
       pmax = p.second.second;
@@ -106,9 +174,21 @@ template <typename T>
 std::unique_ptr<Evaluable<T>>
 CompilerFactory<T>::buildCompiler(const std::string & C_name, Function<T> & fb)
 {
-  auto it = _compiler_registry.find(C_name);
-  if (it == _compiler_registry.end())
+  if (!registry().count(C_name))
+    throw std::out_of_range("Compiler class '" + C_name + "' not found.");
+
+  Polynomial<T> polynomial(fb, polynomialForm(C_name));
+  return constructCompiler(C_name, fb);
+}
+
+template <typename T>
+std::unique_ptr<Evaluable<T>>
+CompilerFactory<T>::constructCompiler(const std::string & C_name, Function<T> & fb)
+{
+  auto it = registry().find(C_name);
+  if (it == registry().end())
     throw std::out_of_range("Compiler class '" + C_name + "' not found.");
+
   return it->second.first(fb);
 }
 
@@ -119,4 +199,145 @@ CompilerFactory<T>::buildBestCompiler(Function<T> & fb)
   return buildCompiler(bestCompiler(), fb);
 }
 
+template <typename T>
+std::unique_ptr<Evaluable<T>>
+CompilerFactory<T>::buildTunedCompiler(Function<T> & fb, std::size_t expected_calls)
+{
+  // the tiered compiler only wraps the other backends
+  std::vector<std::pair<int, std::string>> candidates;
+  for (auto & p : registry())
+    if (p.first != "CompiledTiered")
+      candidates.emplace_back(p.second.second, p.first);
+  std::sort(candidates.begin(), candidates.end());
+
+  // the decision depends on the expression, the available backends, and the call count magnitude
+  auto tuningKey = [&]() {
+    std::string key = fb.format() + '\n' + std::to_string(int(std::log10(expected_calls + 1.0)));
+    for (auto & candidate : candidates)
+      key += '\n' + candidate.second;
+    return DiskCache::hash(key);
+  };
+  const auto key = tuningKey();
+
+  auto cache = DiskCache::global();
+  auto it = tunedCompilers().find(key);
+  if (it == tunedCompilers().end() && cache)
+  {
+    const auto entry = cache->find(key, ".tune");
+    std::string name;
+    if (!entry.empty() && std::getline(std::ifstream(entry), name) && registry().count(name))
+      it = tunedCompilers().emplace(key, name).first;
+  }
+  if (it != tunedCompilers().end())
+    return buildCompiler(it->second, fb);
+
+  std::unique_ptr<Evaluable<T>> best;
+  std::unique_ptr<Function<T>> best_copy;
+  std::string best_name;
+  double best_cost = 0.0;
+  for (auto & candidate : candidates)
+  {
+    auto known = compileTimes().find(candidate.second);
+    if (best && known != compileTimes().end() && known->second > best_cost)
+      continue;
+
+    using clock = std::chrono::steady_clock;
+    auto start = clock::now();
+    // polynomials are rewritten in a copy, so every candidate is compiled from the same tree
+    std::unique_ptr<Function<T>> copy;
+    if (polynomialForm(candidate.second) != PolynomialForm::NONE)
+    {
+      copy = std::unique_ptr<Function<T>>(new Function<T>(FlatIR<T>(fb.root()).toNode()));
+      copy->setNodeTable(fb.nodeTable());
+      copy->setArena(fb.arena());
+    }
+
+    std::unique_ptr<Evaluable<T>> compiled;
+    try
+    {
+      compiled = buildCompiler(candidate.second, copy ? *copy : fb);
+    }
+    catch (std::exception &)
+    {
+      // backend does not support this expression
+      continue;
+    }
+    const double compile_time = std::chrono::duration<double>(clock::now() - start).count();
+    if (known == compileTimes().end() || compile_time < known->second)
+      compileTimes()[candidate.second] = compile_time;
+
+    // compile cost is not monotonic in priority (CompiledCopyPatch compiles faster than
+    // CompiledCCode), so keep trying the remaining backends
+    if (best && compile_time > best_cost)
+      continue;
+
+    // warm up, then time batches of evaluations for at least a millisecond
+    volatile T sink;
+    for (int i = 0; i < 16; ++i)
+      sink = (*compiled)();
+    std::size_t calls = 0;
+    double elapsed = 0.0;
+    start = clock::now();
+    while (elapsed < 1e-3 && calls < 1000000)
+    {
+      for (int i = 0; i < 64; ++i)
+        sink = (*compiled)();
+      calls += 64;
+      elapsed = std::chrono::duration<double>(clock::now() - start).count();
+    }
+    (void)sink;
+
+    const double cost = compile_time + expected_calls * elapsed / calls;
+    if (!best || cost < best_cost)
+    {
+      best = std::move(compiled);
+      best_copy = std::move(copy);
+      best_name = candidate.second;
+      best_cost = cost;
+    }
+  }
+
+  if (!best)
+    throw std::out_of_range("No registered compiler supports the expression.");
+
+  // compile fb itself with the selected backend, which rewrites its polynomials (a later call
+  // with the rewritten fb then finds the decision under the key of the rewritten expression)
+  if (best_copy)
+  {
+    best = buildCompiler(best_name, fb);
+    best_copy.reset();
+  }
+  for (const auto & tuned_key : std::set<std::string>{key, tuningKey()})
+  {
+    tunedCompilers()[tuned_key] = best_name;
+    if (cache)
+    {
+      try
+      {
+        cache->store(tuned_key, ".tune", best_name + '\n');
+      }
+      catch (std::exception &)
+      {
+        // the cache is optional, the decision is still kept for this process
+      }
+    }
+  }
+  return best;
+}
+
+template <typename T>
+void
+CompilerFactory<T>::setPolynomialForm(const std::string & C_name, PolynomialForm form)
+{
+  polynomialForms()[C_name] = form;
+}
+
+template <typename T>
+PolynomialForm
+CompilerFactory<T>::polynomialForm(const std::string & C_name)
+{
+  auto it = polynomialForms().find(C_name);
+  return it == polynomialForms().end() ? PolynomialForm::NONE : it->second;
+}
+
 } // namespace SymbolicMath
@@ -0,0 +1,62 @@
+///
+/// SymbolicMath toolkit
+/// (c) 2017-2020 by Daniel Schwen
+///
+
+#pragma once
+
+#include "SMNodeData.h"
+
+#include <unordered_map>
+
+namespace SymbolicMath
+{
+
+/**
+ * Memoization of derivatives for one differentiation session. The outermost Node::D call on a
+ * thread opens a session, and every subtree reached through shared node data is differentiated
+ * only once per value provider. The cached derivatives are shared in the output, so the
+ * derivative of a DAG is a DAG of comparable size instead of an exponentially growing tree.
+ */
+template <typename T>
+class DerivativeCache
+{
+public:
+  /// cached derivative of data w.r.t. vp (nullptr if not yet computed)
+  NodeDataPtr<T> find(const NodeDataPtr<T> & data, const ValueProvider<T> & vp) const;
+
+  /// store the derivative of data w.r.t. vp
+  void insert(const NodeDataPtr<T> & data, const ValueProvider<T> & vp, NodeDataPtr<T> derivative);
+
+  /// session cache on the current thread (nullptr outside of a differentiation)
+  static DerivativeCache<T> * active() { return current(); }
+
+  /// activate a cache for the lifetime of this object
+  class Scope
+  {
+  public:
+    Scope(DerivativeCache<T> * cache) : _previous(current()) { current() = cache; }
+    ~Scope() { current() = _previous; }
+
+  private:
+    DerivativeCache<T> * _previous;
+  };
+
+protected:
+  using Key = std::pair<const NodeData<T> *, const ValueProvider<T> *>;
+
+  struct KeyHash
+  {
+    std::size_t operator()(const Key & key) const
+    {
+      return std::hash<const void *>{}(key.first) ^ (std::hash<const void *>{}(key.second) << 1);
+    }
+  };
+
+  static DerivativeCache<T> *& current();
+
+  /// the source data is held to keep its address from being reused during the session
+  std::unordered_map<Key, std::pair<NodeDataPtr<T>, NodeDataPtr<T>>, KeyHash> _cache;
+};
+
+} // namespace SymbolicMath
@@ -0,0 +1,79 @@
+///
+/// SymbolicMath toolkit
+/// (c) 2017-2020 by Daniel Schwen
+///
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace SymbolicMath
+{
+
+/**
+ * Content addressed on-disk cache for compiled code (shared objects, object files). Entries are
+ * named by the SHA-256 digest of everything that determines the compiled output (source or IR,
+ * compiler version, and flags), so a hit can be loaded without recompiling. Entries are written
+ * to a temporary file in the cache directory and published with an atomic rename, builds of the
+ * same key are serialized across processes with one of 256 lock files selected by the key (so
+ * concurrent MPI ranks compile each function only once), and the least recently used entries are
+ * evicted once the cache exceeds its size limit. I/O errors are reported with fatalError, the
+ * backends catch them and compile without the cache.
+ *
+ * The global cache is configured through the SYMBOLICMATH_CACHE_DIR (caching is disabled if it
+ * is unset or cannot be created) and SYMBOLICMATH_CACHE_SIZE (limit in megabytes) environment
+ * variables or configure().
+ */
+class DiskCache
+{
+public:
+  DiskCache(const std::string & directory, std::size_t max_bytes);
+
+  /// the process wide cache (nullptr if caching is disabled)
+  static DiskCache * global();
+
+  /// replace the process wide cache (an empty directory disables caching)
+  static void configure(const std::string & directory,
+                        std::size_t max_bytes = default_max_bytes);
+
+  /// hex encoded SHA-256 digest of data
+  static std::string hash(const std::string & data);
+
+  /// path of the existing entry for key (refreshing its last use time) or an empty string
+  std::string find(const std::string & key, const std::string & suffix);
+
+  /// create an empty temporary file in the cache directory and return its path
+  std::string temporary(const std::string & suffix);
+
+  /// atomically move the fully written file tmp into place as the entry for key
+  std::string publish(const std::string & tmp, const std::string & key, const std::string & suffix);
+
+  /// write data to the entry for key
+  std::string store(const std::string & key, const std::string & suffix, const std::string & data);
+
+  /// remove least recently used entries until the cache fits into its size limit
+  void evict();
+
+  /// exclusive lock on a key (and the keys sharing its first byte) held while its entry is
+  /// looked up and built
+  class Lock
+  {
+  public:
+    Lock(const DiskCache & cache, const std::string & key);
+    ~Lock();
+
+  private:
+    int _fd;
+  };
+
+  static const std::size_t default_max_bytes = std::size_t(1024) * 1024 * 1024;
+
+protected:
+  std::string path(const std::string & name) const { return _directory + '/' + name; }
+
+  const std::string _directory;
+  const std::size_t _max_bytes;
+};
+
+} // namespace SymbolicMath
@@ -5,9 +5,28 @@
 
 #pragma once
 
+#include <vector>
+#include <cstddef>
+
 namespace SymbolicMath
 {
 
+/**
+ * Input column for batched evaluation. Binds the variable referenced by a RealReferenceData
+ * value provider to an array of input values (one value per evaluation point).
+ */
+template <typename T>
+struct BatchColumn
+{
+  /// address of the bound variable (as passed to the RealReferenceData constructor)
+  const T * _variable;
+  /// input values for that variable
+  const T * _values;
+};
+
+template <typename T>
+using BatchColumns = std::vector<BatchColumn<T>>;
+
 /**
  * Abstract interface for an object that is evaluable using operator().
  */
@@ -19,6 +38,72 @@ public:
 
   /// Evaluate the node (using JIT if available)
   virtual T operator()() = 0;
+
+  /**
+   * Evaluate the node for n points. Each bound variable is read from its input column, variables
+   * without a column keep their current value. Results are written to output[0..n-1].
+   */
+  virtual void evaluate(const BatchColumns<T> & columns, T * output, std::size_t n);
+
+protected:
+  /// get one input column per variable in vars (variables without a column are broadcast)
+  static std::vector<const T *> gatherColumns(const std::vector<const T *> & vars,
+                                              const BatchColumns<T> & columns,
+                                              std::size_t n,
+                                              std::vector<std::vector<T>> & broadcast);
 };
 
+template <typename T>
+void
+Evaluable<T>::evaluate(const BatchColumns<T> & columns, T * output, std::size_t n)
+{
+  // fallback for backends without native batch support: scatter each point into the bound
+  // variables and call the scalar evaluation
+  std::vector<T> saved;
+  for (auto & column : columns)
+    saved.push_back(*column._variable);
+
+  for (std::size_t i = 0; i < n; ++i)
+  {
+    for (auto & column : columns)
+      *const_cast<T *>(column._variable) = column._values[i];
+    output[i] = (*this)();
+  }
+
+  // restore the bound variables
+  for (std::size_t j = 0; j < columns.size(); ++j)
+    *const_cast<T *>(columns[j]._variable) = saved[j];
+}
+
+template <typename T>
+std::vector<const T *>
+Evaluable<T>::gatherColumns(const std::vector<const T *> & vars,
+                            const BatchColumns<T> & columns,
+                            std::size_t n,
+                            std::vector<std::vector<T>> & broadcast)
+{
+  std::vector<const T *> ret;
+  for (auto var : vars)
+  {
+    const T * values = nullptr;
+    for (auto & column : columns)
+      if (column._variable == var)
+      {
+        values = column._values;
+        break;
+      }
+
+    // no input column was supplied for this variable, use its current value for all points
+    if (!values)
+    {
+      broadcast.emplace_back(n, *var);
+      values = broadcast.back().data();
+    }
+
+    ret.push_back(values);
+  }
+
+  return ret;
+}
+
 } // namespace SymbolicMath
@@ -0,0 +1,95 @@
+///
+/// SymbolicMath toolkit
+/// (c) 2017-2020 by Daniel Schwen
+///
+
+#pragma once
+
+#include "SMNode.h"
+#include "SMNodeData.h"
+
+#include <vector>
+
+namespace SymbolicMath
+{
+
+/**
+ * Flat struct-of-arrays representation of an expression DAG. Every distinct node is stored once
+ * in topological order (children before parents, the root last) as a kind, a type (the operator
+ * or function enum, or the exponent of an integer power), a range in the shared child index
+ * array, and an operand index into the constant or leaf arrays. Analyses and rewrites are linear
+ * scans over these arrays instead of virtual calls and pointer chasing through the tree.
+ */
+template <typename T>
+class FlatIR
+{
+public:
+  enum class Kind : unsigned char
+  {
+    NUMBER,
+    LEAF,
+    UNARY_OPERATOR,
+    BINARY_OPERATOR,
+    MULTINARY_OPERATOR,
+    UNARY_FUNCTION,
+    BINARY_FUNCTION,
+    CONDITIONAL,
+    INTEGER_POWER
+  };
+
+  /// flatten the DAG rooted at root (shared subtrees become single entries)
+  FlatIR(const Node<T> & root);
+
+  /// rebuild a node DAG (shared entries become shared node data)
+  Node<T> toNode() const;
+
+  ///@{ node arrays
+  std::size_t size() const { return _kind.size(); }
+  std::size_t root() const { return _kind.size() - 1; }
+  Kind kind(std::size_t i) const { return _kind[i]; }
+  int type(std::size_t i) const { return _type[i]; }
+  std::size_t nargs(std::size_t i) const { return _first[i + 1] - _first[i]; }
+  std::size_t arg(std::size_t i, std::size_t j) const { return _args[_first[i] + j]; }
+  T constant(std::size_t i) const { return _constants[_operand[i]]; }
+  const NodeDataPtr<T> & leaf(std::size_t i) const { return _leaves[_operand[i]]; }
+  ///@}
+
+  /// structural hash of every node (equal subexpressions have equal hashes)
+  std::vector<std::size_t> hashes() const;
+
+  /// maximum evaluation stack depth of the expression tree (see Node::stackDepth)
+  int stackDepth() const;
+
+  /**
+   * Fold constant subexpressions, constant conditionals, and unit exponents, and drop nodes that
+   * are no longer reachable from the root. Returns the number of removed nodes.
+   */
+  std::size_t fold();
+
+protected:
+  /// append a node with the given child indices
+  void push(Kind kind, int type, const std::vector<std::size_t> & args, std::size_t operand = 0);
+
+  /// replace every node i by forward[i] and remove the unreachable nodes
+  void compact(const std::vector<std::size_t> & forward);
+
+  /// build node i from the given arguments
+  Node<T> build(std::size_t i, const std::vector<Node<T>> & args) const;
+
+  std::vector<Kind> _kind;
+  std::vector<int> _type;
+
+  /// child indices of node i are _args[_first[i]] to _args[_first[i + 1] - 1]
+  std::vector<std::size_t> _first;
+  std::vector<std::size_t> _args;
+
+  /// index into _constants (NUMBER) or _leaves (LEAF)
+  std::vector<std::size_t> _operand;
+
+  std::vector<T> _constants;
+
+  /// value providers, symbols, and local variables are kept as node data
+  std::vector<NodeDataPtr<T>> _leaves;
+};
+
+} // namespace SymbolicMath
@@ -7,6 +7,7 @@
 
 #include "SMNode.h"
 #include "SMEvaluable.h"
+#include "SMNodeTable.h"
 
 namespace SymbolicMath
 {
@@ -26,7 +27,10 @@ class Function : public Evaluable<T>
 {
 public:
   /// Construct form given function or node (shallow copy)
-  Function(const Function<T> & func) : _root(func.root()) {} // TODO: make this deep copy
+  Function(const Function<T> & func)
+    : _root(func.root()), _node_table(func._node_table), _arena(func._arena)
+  {
+  } // TODO: make this deep copy
   Function(const Node<T> & root) : _root(root) {}
   virtual ~Function() {}
 
@@ -38,8 +42,19 @@ public:
   /// Evaluate the node (using JIT if available)
   T operator()() { return _root.value(); }
 
+  /// Evaluate the tree for n points with the bound variables read from the input columns
+  void evaluate(const BatchColumns<T> & columns, T * output, std::size_t n) override;
+
   /// Returns the derivative of the subtree at the node w.r.t. value provider id
-  Function<T> D(ValueProviderPtr<T> vp) const { return Function<T>(_root.D(*vp)); }
+  Function<T> D(ValueProviderPtr<T> vp) const;
+
+  /// intern all nodes created by transforms and derivatives of this function (opt-in)
+  void setNodeTable(std::shared_ptr<NodeTable<T>> table) { _node_table = table; }
+  std::shared_ptr<NodeTable<T>> nodeTable() const { return _node_table; }
+
+  /// allocate all nodes created by transforms and derivatives of this function in arena (opt-in)
+  void setArena(std::shared_ptr<NodeArena> arena) { _arena = arena; }
+  std::shared_ptr<NodeArena> arena() const { return _arena; }
 
   /// reference to the root node
   virtual const Node<T> & root() const { return _root; }
@@ -53,7 +68,46 @@ protected:
   /// data for storing local variables
   LocalVariables _local_variables;
 
+  /// hash consing table (nullptr if interning is off)
+  std::shared_ptr<NodeTable<T>> _node_table;
+
+  /// node allocation arena (nullptr for heap allocation)
+  std::shared_ptr<NodeArena> _arena;
+
   friend class Transform<T>;
 };
 
+template <typename T>
+Function<T>
+Function<T>::D(ValueProviderPtr<T> vp) const
+{
+  typename NodeTable<T>::Scope scope(_node_table.get());
+  NodeArena::Scope arena_scope(_arena.get());
+  Function<T> derivative(_root.D(*vp));
+  derivative._node_table = _node_table;
+  derivative._arena = _arena;
+  return derivative;
+}
+
+template <typename T>
+void
+Function<T>::evaluate(const BatchColumns<T> & columns, T * output, std::size_t n)
+{
+  // the tree reads its inputs through the value provider references, so we scatter each point
+  // into the bound variables and walk the tree directly (bypassing the virtual operator())
+  std::vector<T> saved;
+  for (auto & column : columns)
+    saved.push_back(*column._variable);
+
+  for (std::size_t i = 0; i < n; ++i)
+  {
+    for (auto & column : columns)
+      *const_cast<T *>(column._variable) = column._values[i];
+    output[i] = _root.value();
+  }
+
+  for (std::size_t j = 0; j < columns.size(); ++j)
+    *const_cast<T *>(columns[j]._variable) = saved[j];
+}
+
 } // namespace SymbolicMath
@@ -0,0 +1,137 @@
+///
+/// SymbolicMath toolkit
+/// (c) 2017-2020 by Daniel Schwen
+///
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace SymbolicMath
+{
+
+/**
+ * Bump pointer arena for node data. While an arena is active (see Scope) all node data is
+ * allocated together with its shared_ptr control block from large chunks. Freed nodes are kept
+ * in per size free lists for reuse (transforms discard many nodes), the chunks are released in
+ * one shot once the last owner (see create) has released the arena and all nodes allocated
+ * from it are gone, so nodes may safely outlive the Function or Parser that owns the arena.
+ * Once the arena is no longer owned no more nodes can be allocated from it, so nodes destroyed
+ * after that are only counted instead of being put on the free lists. Nodes may only be allocated
+ * and freed on the thread that created the arena (checked, the bookkeeping is not thread safe).
+ */
+class NodeArena
+{
+public:
+  /**
+   * Create a new arena that lives until the returned pointer and all its nodes are released.
+   * Chunks start small and double in size up to chunk_size, so small functions waste little.
+   */
+  static std::shared_ptr<NodeArena> create(std::size_t chunk_size = 64 * 1024);
+
+  /// allocate n bytes from the free list or the current chunk (starting a new chunk if needed)
+  void * allocate(std::size_t n);
+
+  /// return n bytes at ptr to the free list (or just count them once the arena is no longer owned)
+  void deallocate(void * ptr, std::size_t n);
+
+  ///@{ statistics
+  std::size_t bytesAllocated() const { return _bytes; }
+  std::size_t chunks() const { return _chunks.size(); }
+  ///@}
+
+  /// std::allocator compatible adapter used with std::allocate_shared
+  template <typename U>
+  class Allocator
+  {
+  public:
+    using value_type = U;
+
+    Allocator(NodeArena * arena) : _arena(arena) {}
+    template <typename V>
+    Allocator(const Allocator<V> & other) : _arena(other._arena)
+    {
+    }
+
+    U * allocate(std::size_t n) { return static_cast<U *>(_arena->allocate(n * sizeof(U))); }
+    void deallocate(U * ptr, std::size_t n) { _arena->deallocate(ptr, n * sizeof(U)); }
+
+    template <typename V>
+    bool operator==(const Allocator<V> & other) const
+    {
+      return _arena == other._arena;
+    }
+    template <typename V>
+    bool operator!=(const Allocator<V> & other) const
+    {
+      return _arena != other._arena;
+    }
+
+  private:
+    NodeArena * _arena;
+
+    template <typename V>
+    friend class Allocator;
+  };
+
+  /// construct node data in the active arena (or on the heap if no arena is active)
+  template <typename D, typename... Args>
+  static std::shared_ptr<D> make(Args &&... args)
+  {
+    auto arena = current();
+    if (arena)
+      return std::allocate_shared<D>(Allocator<D>(arena), std::forward<Args>(args)...);
+    return std::make_shared<D>(std::forward<Args>(args)...);
+  }
+
+  /// activate an arena (or fall back to the heap for nullptr) for the lifetime of this object
+  class Scope
+  {
+  public:
+    Scope(NodeArena * arena) : _previous(current()) { current() = arena; }
+    ~Scope() { current() = _previous; }
+
+  private:
+    NodeArena * _previous;
+  };
+
+protected:
+  NodeArena(std::size_t chunk_size);
+
+  /// free the arena once it is neither owned nor holds any live allocations
+  void release();
+
+  /// abort if called on any thread but the owning one
+  void checkThread() const;
+
+  static NodeArena *& current();
+
+  std::vector<std::unique_ptr<char[]>> _chunks;
+  /// maximum and next chunk size
+  std::size_t _chunk_size;
+  std::size_t _grow_size;
+
+  /// free space in the current chunk
+  char * _next;
+  std::size_t _left;
+
+  /// total number of bytes taken from the chunks
+  std::size_t _bytes;
+
+  /// number of allocations not yet returned
+  std::size_t _live;
+
+  /// set while a shared_ptr returned by create exists
+  bool _owned;
+
+  /// thread that created the arena
+  const std::thread::id _owner;
+
+  /// heads of the singly linked free lists (indexed by size in units of the alignment)
+  std::vector<void *> _free;
+};
+
+} // namespace SymbolicMath
@@ -6,13 +6,16 @@
 #pragma once
 
 #include <vector>
+#include <map>
 #include <memory>
 #include <array>
 #include <cmath>
 #include <functional>
 #include <type_traits>
+#include <cstdint>
 
 #include "SMNode.h"
+#include "SMNodeArena.h"
 
 namespace SymbolicMath
 {
@@ -72,7 +75,31 @@ public:
   /// amount of net stack pointer movement of this operator
   virtual void stackDepth(std::pair<int, int> & current_max) const;
 
+  /**
+   * Bit mask of the value providers this subtree depends on (each value provider sets the bit
+   * hash() % 64). A cleared bit guarantees independence. The mask is computed on first use and
+   * cached; transforms may only replace arguments by equivalent subtrees, which keeps it a
+   * valid superset.
+   */
+  std::uint64_t dependencies() const
+  {
+    if (!_dependencies_known)
+    {
+      _dependencies = computeDependencies();
+      _dependencies_known = true;
+    }
+    return _dependencies;
+  }
+
   friend Node<T>;
+
+protected:
+  /// conservatively assume a dependence on every value provider
+  virtual std::uint64_t computeDependencies() const { return ~std::uint64_t(0); }
+
+private:
+  mutable std::uint64_t _dependencies = 0;
+  mutable bool _dependencies_known = false;
 };
 
 /**
@@ -126,6 +153,13 @@ public:
       arg.stackDepth(current_max);
     current_max.first -= N - 1;
   }
+  std::uint64_t computeDependencies() const override
+  {
+    std::uint64_t mask = 0;
+    for (auto & arg : _args)
+      mask |= arg._data->dependencies();
+    return mask;
+  }
 
   Enum _type;
   std::array<Node<T>, N> _args;
@@ -157,6 +191,13 @@ public:
       arg.stackDepth(current_max);
     current_max.first -= _args.size() - 1;
   }
+  std::uint64_t computeDependencies() const override
+  {
+    std::uint64_t mask = 0;
+    for (auto & arg : _args)
+      mask |= arg._data->dependencies();
+    return mask;
+  }
 
   Enum _type;
   std::vector<Node<T>> _args;
@@ -178,6 +219,10 @@ public:
   bool is(ValueProvider<T> * a) const override { return getTypeID() == a->getTypeID(); }
 
   void stackDepth(std::pair<int, int> & current_max) const override { current_max.first++; }
+  std::uint64_t computeDependencies() const override
+  {
+    return std::uint64_t(1) << (this->hash() % 64);
+  }
 
   std::string _name;
 
@@ -209,18 +254,27 @@ template <class C, typename T>
 int ValueProviderDerived<C, T>::_vp_typeinfo_tag;
 
 /**
- * Local variable that is defined using the := operator
+ * Local variable that is defined using the := operator. Every local variable is assigned exactly
+ * once (the parser introduces a new local variable for each reassignment). The tree evaluation
+ * stores the assigned value here, the compilers keep it in a slot, register, or temporary.
  */
 template <typename T>
 class LocalVariableData : public NodeData<T>
 {
 public:
-  LocalVariableData(std::size_t id) : _id(id) {}
+  LocalVariableData(std::size_t id) : _id(id), _name("V" + stringify(id)), _assigned(false) {}
+
+  /// derivative of local w.r.t. vp
+  LocalVariableData(const LocalVariableData<T> & local, const ValueProvider<T> & vp)
+    : _id(local._id), _name("d" + local._name + "/d" + vp.format()), _assigned(false)
+  {
+  }
+
   Node<T> getArg(unsigned int i) override { fatalError("Node has no arguments"); };
 
   T value() const override;
 
-  std::string format() const override { return "{V" + stringify(_id) + "}"; }
+  std::string format() const override { return "{" + _name + "}"; }
 
   std::size_t id() { return _id; }
 
@@ -229,10 +283,25 @@ public:
   NodeDataPtr<T> clone() override { fatalError("Cannot clone local variable"); };
   std::size_t hash() const override { return std::hash<const void *>{}(this); }
 
-  Node<T> D(const ValueProvider<T> & vp) override { fatalError("Not implemented"); };
+  Node<T> D(const ValueProvider<T> & vp) override;
   void apply(Node<T> & node, Transform<T> & transform) override;
 
+  /// store the value of an assignment
+  void assign(T value)
+  {
+    _value = value;
+    _assigned = true;
+  }
+
   std::size_t _id;
+  std::string _name;
+
+  /// derivative locals introduced by differentiating the assignment of this local
+  std::map<const ValueProvider<T> *, NodeDataPtr<T>> _derivatives;
+
+protected:
+  T _value;
+  bool _assigned;
 };
 
 /**
@@ -328,6 +397,7 @@ public:
   Node<T> D(const ValueProvider<T> &) override { return Node<T>(0.0); }
 
   void stackDepth(std::pair<int, int> & current_max) const override { current_max.first++; }
+  std::uint64_t computeDependencies() const override { return 0; }
 
   NumberType _type;
 };
@@ -347,7 +417,7 @@ public:
 
   std::string format() const override { return stringify(_value); };
 
-  NodeDataPtr<T> clone() override { return std::make_shared<RealNumberData>(_value); };
+  NodeDataPtr<T> clone() override { return NodeArena::make<RealNumberData>(_value); };
   std::size_t hash() const override { return std::hash<Real>{}(_value); }
 
   bool is(NumberType type) const override;
@@ -406,6 +476,15 @@ public:
   void apply(Node<T> & node, Transform<T> & transform) override;
 
   unsigned short precedence() const override;
+
+protected:
+  /// assignments and lists have side effects and are never treated as constant
+  std::uint64_t computeDependencies() const override
+  {
+    if (_type == BinaryOperatorType::ASSIGNMENT || _type == BinaryOperatorType::LIST)
+      return ~std::uint64_t(0);
+    return FixedArgumentData<T, BinaryOperatorType, 2>::computeDependencies();
+  }
 };
 
 /**
@@ -430,6 +509,15 @@ public:
 
   unsigned short precedence() const override;
   void apply(Node<T> & node, Transform<T> & transform) override;
+
+protected:
+  /// lists have side effects and are never treated as constant
+  std::uint64_t computeDependencies() const override
+  {
+    if (_type == MultinaryOperatorType::LIST)
+      return ~std::uint64_t(0);
+    return MultinaryData<T, MultinaryOperatorType>::computeDependencies();
+  }
 };
 
 /**
@@ -517,7 +605,7 @@ public:
   std::string format() const override;
   std::string formatTree(std::string indent) const override;
 
-  NodeDataPtr<T> clone() override { return std::make_shared<IntegerPowerData>(_arg, _exponent); };
+  NodeDataPtr<T> clone() override { return NodeArena::make<IntegerPowerData>(_arg, _exponent); };
 
   Node<T> getArg(unsigned int i) override;
   std::size_t size() const override { return 1; }
@@ -531,6 +619,7 @@ public:
   {
     _arg.stackDepth(current_max);
   }
+  std::uint64_t computeDependencies() const override { return _arg._data->dependencies(); }
   void apply(Node<T> & node, Transform<T> & transform) override;
 
   Node<T> _arg;
@@ -6,6 +6,8 @@
 #include "SMNode.h"
 #include "SMTransform.h"
 #include "SMNodeData.h"
+#include "SMNodeTable.h"
+#include "SMDerivativeCache.h"
 
 #include <memory>
 
@@ -25,7 +27,7 @@ Node<T>::clone()
 }
 
 template <typename T>
-Node<T>::Node(T val) : _data(std::make_shared<RealNumberData<T>>(val))
+Node<T>::Node(T val) : _data(NodeTable<T>::make(NodeArena::make<RealNumberData<T>>(val)))
 {
 }
 
@@ -33,48 +35,48 @@ template <typename T>
 Node<T>
 Node<T>::fromReal(Real val)
 {
-  return Node<T>(std::make_shared<RealNumberData<T>>(val));
+  return Node<T>(NodeTable<T>::make(NodeArena::make<RealNumberData<T>>(val)));
 }
 
 template <typename T>
 Node<T>::Node(UnaryOperatorType type, Node arg)
-  : _data(std::make_shared<UnaryOperatorData<T>>(type, arg))
+  : _data(NodeTable<T>::make(NodeArena::make<UnaryOperatorData<T>>(type, arg)))
 {
 }
 
 template <typename T>
 Node<T>::Node(BinaryOperatorType type, Node arg0, Node arg1)
-  : _data(std::make_shared<BinaryOperatorData<T>>(type, arg0, arg1))
+  : _data(NodeTable<T>::make(NodeArena::make<BinaryOperatorData<T>>(type, arg0, arg1)))
 {
 }
 
 template <typename T>
 Node<T>::Node(MultinaryOperatorType type, std::vector<Node> args)
-  : _data(std::make_shared<MultinaryOperatorData<T>>(type, args))
+  : _data(NodeTable<T>::make(NodeArena::make<MultinaryOperatorData<T>>(type, args)))
 {
 }
 
 template <typename T>
 Node<T>::Node(UnaryFunctionType type, Node arg)
-  : _data(std::make_shared<UnaryFunctionData<T>>(type, arg))
+  : _data(NodeTable<T>::make(NodeArena::make<UnaryFunctionData<T>>(type, arg)))
 {
 }
 
 template <typename T>
 Node<T>::Node(BinaryFunctionType type, Node arg0, Node arg1)
-  : _data(std::make_shared<BinaryFunctionData<T>>(type, arg0, arg1))
+  : _data(NodeTable<T>::make(NodeArena::make<BinaryFunctionData<T>>(type, arg0, arg1)))
 {
 }
 
 template <typename T>
 Node<T>::Node(ConditionalType type, Node arg0, Node arg1, Node arg2)
-  : _data(std::make_shared<ConditionalData<T>>(type, arg0, arg1, arg2))
+  : _data(NodeTable<T>::make(NodeArena::make<ConditionalData<T>>(type, arg0, arg1, arg2)))
 {
 }
 
 template <typename T>
 Node<T>::Node(IntegerPowerType, Node arg, int exponent)
-  : _data(std::make_shared<IntegerPowerData<T>>(arg, exponent))
+  : _data(NodeTable<T>::make(NodeArena::make<IntegerPowerData<T>>(arg, exponent)))
 {
 }
 
@@ -269,7 +271,31 @@ template <typename T>
 Node<T>
 Node<T>::D(const ValueProvider<T> & vp) const
 {
-  return Node(_data->D(vp));
+  // the outermost call opens a differentiation session
+  auto cache = DerivativeCache<T>::active();
+  if (!cache)
+  {
+    DerivativeCache<T> session;
+    typename DerivativeCache<T>::Scope scope(&session);
+    return D(vp);
+  }
+
+  // subtrees that do not depend on vp
+  if ((_data->dependencies() & vp.dependencies()) == 0)
+    return Node<T>(0.0);
+
+  // leaves are cheap to differentiate, and data with a single owner cannot be reached twice
+  if (_data->size() == 0 || _data.use_count() == 1)
+    return Node(_data->D(vp));
+
+  // differentiate shared subtrees only once
+  auto derivative = cache->find(_data, vp);
+  if (!derivative)
+  {
+    derivative = _data->D(vp)._data;
+    cache->insert(_data, vp, derivative);
+  }
+  return Node(derivative);
 }
 
 template <typename T>
@@ -0,0 +1,88 @@
+///
+/// SymbolicMath toolkit
+/// (c) 2017-2020 by Daniel Schwen
+///
+
+#pragma once
+
+#include "SMNodeData.h"
+
+#include <cstdint>
+#include <map>
+#include <typeindex>
+
+namespace SymbolicMath
+{
+
+/**
+ * Hash consing table for node data. While a table is active (see Scope) all Node constructors
+ * and Transform::set calls return the existing NodeDataPtr for structurally identical nodes, so
+ * identical subtrees are stored once and structural equality becomes a pointer comparison.
+ * Interned node data is immutable; transforms must modify private copies (see
+ * Transform::copyOnWrite). Entries only hold weak references to the node data.
+ */
+template <typename T>
+class NodeTable
+{
+public:
+  NodeTable() : _purge_size(1024) {}
+
+  /// return the interned data structurally identical to data (registering data if it is new)
+  NodeDataPtr<T> intern(NodeDataPtr<T> data);
+
+  /// check if data is the interned representative of its structure
+  bool contains(const NodeDataPtr<T> & data) const;
+
+  /// number of entries (including entries of node data that no longer exists)
+  std::size_t size() const { return _table.size(); }
+
+  /// remove entries of node data that no longer exists
+  void purge();
+
+  /// table used on the current thread (nullptr if interning is off)
+  static NodeTable<T> * active() { return current(); }
+
+  /// intern data in the active table (if any)
+  static NodeDataPtr<T> make(NodeDataPtr<T> data)
+  {
+    auto table = current();
+    return table ? table->intern(data) : data;
+  }
+
+  /// activate a table (or disable interning for nullptr) for the lifetime of this object
+  class Scope
+  {
+  public:
+    Scope(NodeTable<T> * table) : _previous(current()) { current() = table; }
+    ~Scope() { current() = _previous; }
+
+  private:
+    NodeTable<T> * _previous;
+  };
+
+protected:
+  /// node kind, type enum (or exponent), constant value, variable reference, and child identities
+  struct Key
+  {
+    Key(const NodeData<T> & data);
+    bool operator<(const Key & other) const;
+
+    std::type_index _kind;
+    int _type;
+    std::uint64_t _value;
+    const void * _ref;
+    std::vector<const NodeData<T> *> _args;
+
+    /// symbols, local variables, and arrays are not interned
+    bool _internable;
+  };
+
+  static NodeTable<T> *& current();
+
+  std::map<Key, std::weak_ptr<NodeData<T>>> _table;
+
+  /// table size that triggers the next purge
+  std::size_t _purge_size;
+};
+
+} // namespace SymbolicMath
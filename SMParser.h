@@ -15,6 +15,7 @@
 #include <string>
 #include <stack>
 #include <map>
+#include <set>
 
 namespace SymbolicMath
 {
@@ -36,10 +37,22 @@ public:
 
   void registerQPIndex(const unsigned int & qp) { _qp_ptr = &qp; }
 
+  /// intern the nodes of parsed functions (and their transforms and derivatives) in table
+  void setNodeTable(std::shared_ptr<NodeTable<T>> table) { _node_table = table; }
+
+  /// allocate the nodes of parsed functions (and their transforms and derivatives) in arena
+  void setArena(std::shared_ptr<NodeArena> arena) { _arena = arena; }
+
 protected:
   void pushToOutput(TokenPtr<T> token);
   void pushFunctionToOutput(TokenPtr<T> token, unsigned int num_arguments);
 
+  /// check the local variable on the output stack and give it a fresh id if it is reassigned
+  void pushAssignmentToOutput(TokenPtr<T> token);
+
+  /// check that assignments and lists are only used as statements and locals are assigned first
+  void validateStatements(const Node<T> & root);
+
   void preprocessToken();
   void validateToken();
 
@@ -59,12 +72,24 @@ private:
   /// value provider ID map
   std::map<std::string, std::shared_ptr<ValueProvider<T>>> _value_providers;
 
-  /// local variable ID map
+  /// local variable ID map (the current version of each name)
   std::map<std::string, std::shared_ptr<LocalVariableData<T>>> _local_variables;
 
+  /// number of local variables created while parsing the current expression
+  std::size_t _local_variable_count;
+
+  /// local variables that have been assigned in the current expression
+  std::set<const LocalVariableData<T> *> _assigned;
+
   /// pointer to the quadrature point index (_qp)
   const unsigned int * _qp_ptr;
 
+  /// hash consing table handed to parsed functions (nullptr if interning is off)
+  std::shared_ptr<NodeTable<T>> _node_table;
+
+  /// node allocation arena handed to parsed functions (nullptr for heap allocation)
+  std::shared_ptr<NodeArena> _arena;
+
   /// currently parsed expression
   std::string _expression;
 
@@ -51,6 +51,16 @@ protected:
 
   void apply();
 
+  /// root node of the transformed function
+  Node<T> & root();
+
+  /**
+   * Apply the transform to a private copy of the node data if it is interned in the active node
+   * table. Transforms that modify node data in place call this first and return if it returns
+   * true.
+   */
+  bool copyOnWrite(Node<T> & node);
+
   void set(Node<T> & node, Real val);
   void set(Node<T> & node, UnaryOperatorType type, Node<T> arg);
   void set(Node<T> & node, BinaryOperatorType type, Node<T> arg0, Node<T> arg1);
@@ -0,0 +1,51 @@
+///
+/// SymbolicMath toolkit
+/// (c) 2017-2020 by Daniel Schwen
+///
+
+#pragma once
+
+#include "SMTransformHash.h"
+
+#include <set>
+
+namespace SymbolicMath
+{
+
+/**
+ * Common subexpression elimination. Structurally identical subtrees are merged into a single
+ * shared NodeData object, turning the expression tree into a DAG. Candidates are found through
+ * the structural hash and verified for equality before merging. The compiled backends evaluate
+ * each shared subtree only once. Apply this transform last, after simplification.
+ */
+template <typename T>
+class CSE : public Hash<T>
+{
+public:
+  CSE(Function<T> & fb);
+
+  /// number of subtrees that were replaced by a reference to an identical subtree
+  std::size_t eliminated() const { return _eliminated; }
+
+  /// non-leaf nodes that are referenced from more than one parent node
+  static std::set<const NodeData<T> *> sharedNodes(const Node<T> & root);
+
+  /**
+   * Structural equality of two nodes. Unless deep is set the child nodes are expected to be
+   * merged already and are compared by identity.
+   */
+  static bool equivalent(const NodeData<T> * a, const NodeData<T> * b, bool deep = false);
+
+protected:
+  void setHash(Node<T> &, std::size_t) override;
+
+  using Hash<T>::_hash;
+  using Hash<T>::_hash_map;
+
+  /// replaced node data (kept alive until the transform is done, _hash_map points into it)
+  std::vector<NodeDataPtr<T>> _retired;
+
+  std::size_t _eliminated;
+};
+
+} // namespace SymbolicMath
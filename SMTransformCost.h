@@ -0,0 +1,70 @@
+///
+/// SymbolicMath toolkit
+/// (c) 2017-2020 by Daniel Schwen
+///
+
+#pragma once
+
+#include "SMTransform.h"
+
+#include <unordered_set>
+
+namespace SymbolicMath
+{
+
+/**
+ * Cost estimate visitor. Counts the distinct nodes of a function and estimates the floating
+ * point operations needed to evaluate each of them once (additions and multiplications count
+ * as one, divisions and square roots as four, and transcendental functions as twenty).
+ */
+template <typename T>
+class Cost : public Transform<T>
+{
+  using Transform<T>::apply;
+
+public:
+  Cost(Function<T> & fb);
+
+  void operator()(Node<T> &, SymbolData<T> &) override;
+
+  void operator()(Node<T> &, UnaryOperatorData<T> &) override;
+  void operator()(Node<T> &, BinaryOperatorData<T> &) override;
+  void operator()(Node<T> &, MultinaryOperatorData<T> &) override;
+
+  void operator()(Node<T> &, UnaryFunctionData<T> &) override;
+  void operator()(Node<T> &, BinaryFunctionData<T> &) override;
+
+  void operator()(Node<T> &, RealNumberData<T> &) override;
+  void operator()(Node<T> &, RealReferenceData<T> &) override;
+  void operator()(Node<T> &, RealArrayReferenceData<T> &) override;
+  void operator()(Node<T> &, LocalVariableData<T> &) override;
+
+  void operator()(Node<T> &, ConditionalData<T> &) override;
+  void operator()(Node<T> &, IntegerPowerData<T> &) override;
+
+  ///@{ results
+  std::size_t nodes() const { return _nodes; }
+  std::size_t flops() const { return _flops; }
+  ///@}
+
+  ///@{ estimated flops of a single operation
+  static std::size_t cost(UnaryOperatorType);
+  static std::size_t cost(BinaryOperatorType);
+  static std::size_t cost(MultinaryOperatorType, std::size_t nargs);
+  static std::size_t cost(UnaryFunctionType);
+  static std::size_t cost(BinaryFunctionType);
+  static std::size_t cost(ConditionalType);
+  static std::size_t cost(IntegerPowerType, int exponent);
+  ///@}
+
+protected:
+  /// count a node the first time it is encountered
+  void visit(Node<T> & node);
+
+  std::unordered_set<const NodeData<T> *> _visited;
+
+  std::size_t _nodes;
+  std::size_t _flops;
+};
+
+} // namespace SymbolicMath
@@ -0,0 +1,159 @@
+///
+/// SymbolicMath toolkit
+/// (c) 2017-2020 by Daniel Schwen
+///
+
+#pragma once
+
+#include "SMTransform.h"
+#include "SMFlatIR.h"
+
+#include <chrono>
+#include <unordered_map>
+
+namespace SymbolicMath
+{
+
+/**
+ * Equality saturation optimizer. The function is added to an e-graph (classes of equivalent
+ * expressions with hash consed e-nodes), a set of algebraic rewrite rules is applied to all
+ * e-nodes until no new equivalences are found or the node or time limit is reached, and the
+ * cheapest expression under the Cost operation table is extracted. Unlike the greedy Simplify
+ * rules this can factor a*b + a*c = a*(b + c) or rewrite x/y/z = x/(y*z) without getting stuck
+ * on intermediate forms that are not cheaper by themselves.
+ *
+ * Like -ffast-math the rules reassociate floating point operations and replace divisions by
+ * constants with multiplications by their reciprocals.
+ */
+template <typename T>
+class EGraph : public Transform<T>
+{
+  using Transform<T>::root;
+
+public:
+  EGraph(Function<T> & fb, std::size_t max_nodes = 20000, double max_seconds = 0.2);
+
+  void operator()(Node<T> &, SymbolData<T> &) override;
+
+  void operator()(Node<T> &, UnaryOperatorData<T> &) override;
+  void operator()(Node<T> &, BinaryOperatorData<T> &) override;
+  void operator()(Node<T> &, MultinaryOperatorData<T> &) override;
+
+  void operator()(Node<T> &, UnaryFunctionData<T> &) override;
+  void operator()(Node<T> &, BinaryFunctionData<T> &) override;
+
+  void operator()(Node<T> &, RealNumberData<T> &) override;
+  void operator()(Node<T> &, RealReferenceData<T> &) override;
+  void operator()(Node<T> &, RealArrayReferenceData<T> &) override;
+  void operator()(Node<T> &, LocalVariableData<T> &) override;
+
+  void operator()(Node<T> &, ConditionalData<T> &) override;
+  void operator()(Node<T> &, IntegerPowerData<T> &) override;
+
+  ///@{ statistics
+  std::size_t size() const { return _enodes; }
+  unsigned int iterations() const { return _iterations; }
+  bool saturated() const { return _saturated; }
+  ///@}
+
+protected:
+  using Id = std::size_t;
+  using Kind = typename FlatIR<T>::Kind;
+
+  struct ENode
+  {
+    Kind _kind;
+    /// operator or function enum, or the exponent of an integer power
+    int _type;
+    std::vector<Id> _args;
+    T _value;
+    NodeDataPtr<T> _leaf;
+
+    bool operator==(const ENode & other) const;
+  };
+
+  struct ENodeHash
+  {
+    std::size_t operator()(const ENode & node) const;
+  };
+
+  /// add the node data DAG rooted at node (shared data is added once)
+  Id add(Node<T> & node);
+
+  /// add an e-node and return its class (constant e-nodes are folded)
+  Id add(ENode node);
+  Id add(Kind kind, int type, std::vector<Id> args);
+
+  ///@{ classes of a number and of a product of factors (a single factor is returned as is)
+  Id number(T value);
+  Id product(std::vector<Id> factors);
+  ///@}
+
+  /// replace the arguments by their canonical classes (sorted for commutative operators)
+  void canonicalize(ENode & node);
+
+  /// canonical class of id
+  Id find(Id id);
+
+  /// merge two classes, returns false if they already were the same
+  bool merge(Id a, Id b);
+
+  /// restore the hash consing invariant after merges (congruence closure)
+  void rebuild();
+
+  /// apply all rewrite rules to every e-node once, returns false if nothing changed
+  bool rewrite();
+
+  ///@{ rewrite rules for a single e-node of class id
+  void rewriteDivision(Id id, const ENode & node);
+  void rewriteSum(Id id, const ENode & node);
+  void rewriteProduct(Id id, const ENode & node);
+  ///@}
+
+  /// factor the terms i and j of a sum or difference if they share a factor or a divisor
+  void factor(Id id, const ENode & node, std::size_t i, std::size_t j);
+
+  /// e-nodes of a given kind and type in class id
+  std::vector<ENode> nodes(Id id, Kind kind, int type);
+
+  /// pointer to the number e-node of class id (nullptr if the class is not constant)
+  const ENode * constant(Id id);
+
+  /// operation cost of an e-node (at least one for anything but numbers and leaves)
+  static double cost(const ENode & node);
+
+  /// cheapest node of class id under the cost table
+  Node<T> extract(Id id, std::vector<std::size_t> & best, std::vector<NodeDataPtr<T>> & built);
+
+  /// node for an e-node with the given (extracted) arguments
+  static Node<T> build(const ENode & node, const std::vector<Node<T>> & args);
+
+  /// check the node and time limits
+  bool exhausted() const;
+
+  /// e-nodes and the union-find parent for each class
+  std::vector<std::vector<ENode>> _nodes;
+  std::vector<Id> _parent;
+
+  /// hash consing table of canonical e-nodes
+  std::unordered_map<ENode, Id, ENodeHash> _memo;
+
+  /// classes of the already added node data
+  std::unordered_map<const NodeData<T> *, Id> _added;
+
+  /// class of the e-node added by the last visitor call
+  Id _last;
+
+  std::size_t _max_nodes;
+  std::size_t _enodes;
+  double _max_seconds;
+  std::chrono::steady_clock::time_point _start;
+
+  unsigned int _iterations;
+  bool _saturated;
+
+  /// upper limit for the number of rewrite iterations
+  static const unsigned int _max_iterations = 16;
+};
+
+} // namespace SymbolicMath
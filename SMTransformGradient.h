@@ -0,0 +1,71 @@
+///
+/// SymbolicMath toolkit
+/// (c) 2017-2020 by Daniel Schwen
+///
+
+#pragma once
+
+#include "SMTransform.h"
+#include "SMFunction.h"
+
+#include <map>
+
+namespace SymbolicMath
+{
+
+/**
+ * Reverse mode (adjoint) differentiation. Builds the derivatives of a function with respect to
+ * a list of value providers in a single backward sweep over the expression. The adjoint of each
+ * node is built once and shared by all of its children, so the value and the full gradient form
+ * one DAG whose size is a small multiple of the original expression. Each output is an ordinary
+ * Function that can be simplified and compiled with any backend (apply CSE before compiling to
+ * share common subexpressions).
+ */
+template <typename T>
+class Gradient : public Transform<T>
+{
+public:
+  Gradient(Function<T> & fb, const std::vector<ValueProviderPtr<T>> & vps);
+
+  void operator()(Node<T> &, SymbolData<T> &) override;
+
+  void operator()(Node<T> &, UnaryOperatorData<T> &) override;
+  void operator()(Node<T> &, BinaryOperatorData<T> &) override;
+  void operator()(Node<T> &, MultinaryOperatorData<T> &) override;
+
+  void operator()(Node<T> &, UnaryFunctionData<T> &) override;
+  void operator()(Node<T> &, BinaryFunctionData<T> &) override;
+
+  void operator()(Node<T> &, RealNumberData<T> &) override;
+  void operator()(Node<T> &, RealReferenceData<T> &) override;
+  void operator()(Node<T> &, RealArrayReferenceData<T> &) override;
+  void operator()(Node<T> &, LocalVariableData<T> &) override;
+
+  void operator()(Node<T> &, ConditionalData<T> &) override;
+  void operator()(Node<T> &, IntegerPowerData<T> &) override;
+
+  /// derivatives in the order of the value providers passed to the constructor
+  std::vector<Function<T>> & gradient() { return _gradient; }
+  Function<T> & operator[](std::size_t i) { return _gradient[i]; }
+
+protected:
+  /// add the current adjoint times the partial derivative to the adjoint of child
+  void contribute(const Node<T> & child, Node<T> partial);
+  void contribute(const Node<T> & child);
+
+  /// sum of the accumulated contributions
+  static Node<T> sum(const std::vector<Node<T>> & contributions);
+
+  /// adjoint of the node currently being visited
+  Node<T> _adjoint;
+
+  /// adjoint contributions from the parents of each node
+  std::map<const NodeData<T> *, std::vector<Node<T>>> _contributions;
+
+  /// adjoint contributions for each variable
+  std::map<const T *, std::vector<Node<T>>> _variables;
+
+  std::vector<Function<T>> _gradient;
+};
+
+} // namespace SymbolicMath
@@ -40,7 +40,10 @@ public:
   void operator()(Node<T> &, IntegerPowerData<T> &) override;
 
 protected:
-  void setHash(Node<T> &, std::size_t);
+  /// construct without hashing the function (for derived transforms)
+  Hash(Function<T> & fb, bool hash_now);
+
+  virtual void setHash(Node<T> &, std::size_t);
 
   std::size_t _hash;
   std::multimap<std::size_t, Node<T> *> _hash_map;
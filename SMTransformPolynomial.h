@@ -0,0 +1,95 @@
+///
+/// SymbolicMath toolkit
+/// (c) 2017-2020 by Daniel Schwen
+///
+
+#pragma once
+
+#include "SMTransform.h"
+
+#include <map>
+#include <unordered_map>
+
+namespace SymbolicMath
+{
+
+/// evaluation scheme for polynomial sums
+enum class PolynomialForm
+{
+  NONE,
+  HORNER,
+  ESTRIN
+};
+
+/**
+ * Polynomial evaluation visitor. Sums of products of numbers and integer powers of at most two
+ * common subexpressions (c, T, or (1 - 2*c) in Redlich-Kister terms) are rewritten into nested
+ * Horner form (fewest operations, one long dependency chain) or Estrin form (a balanced tree of
+ * independent multiply-adds for backends that exploit instruction-level parallelism). Bivariate
+ * polynomials are nested, the coefficients of the outer variable are polynomials in the inner
+ * one. Coefficient constants are used as they appear in the input and are never combined.
+ */
+template <typename T>
+class Polynomial : public Transform<T>
+{
+  using Transform<T>::set;
+  using Transform<T>::apply;
+
+public:
+  Polynomial(Function<T> & fb, PolynomialForm form = PolynomialForm::HORNER);
+
+  void operator()(Node<T> &, SymbolData<T> &) override {}
+
+  void operator()(Node<T> &, UnaryOperatorData<T> &) override;
+  void operator()(Node<T> &, BinaryOperatorData<T> &) override;
+  void operator()(Node<T> &, MultinaryOperatorData<T> &) override;
+
+  void operator()(Node<T> &, UnaryFunctionData<T> &) override;
+  void operator()(Node<T> &, BinaryFunctionData<T> &) override;
+
+  void operator()(Node<T> &, RealNumberData<T> &) override {}
+  void operator()(Node<T> &, RealReferenceData<T> &) override {}
+  void operator()(Node<T> &, RealArrayReferenceData<T> &) override {}
+  void operator()(Node<T> &, LocalVariableData<T> &) override {}
+
+  void operator()(Node<T> &, ConditionalData<T> &) override;
+  void operator()(Node<T> &, IntegerPowerData<T> &) override;
+
+  /// number of rewritten polynomials
+  std::size_t rewritten() const { return _rewritten; }
+
+protected:
+  /// a summand as a coefficient times powers of the variables
+  struct Term
+  {
+    std::vector<int> _powers;
+    Node<T> _coefficient;
+  };
+
+  /// rewrite a child (shared node data is rewritten only once)
+  void visit(Node<T> & node);
+
+  /// index of the variable equivalent to base (adds it if allowed, -1 otherwise)
+  int variable(const Node<T> & base, std::vector<Node<T>> & variables, bool add);
+
+  /// nested polynomial in the variables from v on
+  Node<T> build(const std::vector<Term> & terms, std::size_t v);
+
+  ///@{ univariate schemes for the coefficients of the powers of x
+  Node<T> horner(const std::map<int, Node<T>> & coefficients, const Node<T> & x);
+  Node<T> estrin(const std::map<int, Node<T>> & coefficients, const Node<T> & x);
+  ///@}
+
+  /// the variables of the polynomial being rewritten
+  std::vector<Node<T>> _variables;
+
+  /// rewritten node data for every visited node data (the key is held to keep its address unique)
+  std::unordered_map<const NodeData<T> *, std::pair<NodeDataPtr<T>, NodeDataPtr<T>>> _rewrites;
+
+  const PolynomialForm _form;
+  std::size_t _rewritten;
+
+  static const std::size_t _max_variables = 2;
+};
+
+} // namespace SymbolicMath
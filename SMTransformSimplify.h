@@ -11,7 +11,9 @@ namespace SymbolicMath
 {
 
 /**
- * Simplification visitor
+ * Simplification visitor. The local rewrite rules (constant folding, identities, collection of
+ * like terms and powers, and cancellation of inverse functions) are applied repeatedly until
+ * the cost estimate of the function no longer decreases.
  */
 template <typename T>
 class Simplify : public Transform<T>
@@ -22,6 +24,11 @@ class Simplify : public Transform<T>
 public:
   Simplify(Function<T> & fb);
 
+  ///@{ number of distinct nodes and estimated flops removed by the simplification
+  std::ptrdiff_t removedNodes() const { return _removed_nodes; }
+  std::ptrdiff_t removedFlops() const { return _removed_flops; }
+  ///@}
+
   void operator()(Node<T> &, SymbolData<T> &) override {}
 
   void operator()(Node<T> &, UnaryOperatorData<T> &) override;
@@ -38,6 +45,28 @@ public:
 
   void operator()(Node<T> &, ConditionalData<T> &) override;
   void operator()(Node<T> &, IntegerPowerData<T> &) override;
+
+protected:
+  /// replace a subtree that does not depend on any value provider by its value
+  bool foldConstant(Node<T> & node);
+
+  /// merge summands with identical non-numeric factors (2*x + 3*x = 5*x)
+  void collectTerms(std::vector<Node<T>> & args);
+
+  /// merge factors with identical bases into integer powers (x*x*x = x^3)
+  void collectPowers(std::vector<Node<T>> & args);
+
+  /// operands of node if it is a type operator, or node itself
+  static std::vector<Node<T>> operands(const Node<T> & node, MultinaryOperatorType type);
+
+  /// replace node by a type operator on args (dropping the operator for fewer than two operands)
+  void setOperands(Node<T> & node, MultinaryOperatorType type, std::vector<Node<T>> & args);
+
+  /// upper limit for the number of passes
+  static const unsigned int _max_passes = 16;
+
+  std::ptrdiff_t _removed_nodes;
+  std::ptrdiff_t _removed_flops;
 };
 
 } // namespace SymbolicMath
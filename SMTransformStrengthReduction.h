@@ -0,0 +1,81 @@
+///
+/// SymbolicMath toolkit
+/// (c) 2017-2020 by Daniel Schwen
+///
+
+#pragma once
+
+#include "SMTransform.h"
+
+#include <map>
+#include <unordered_map>
+
+namespace SymbolicMath
+{
+
+/**
+ * Strength reduction visitor. Replaces expensive operations by cheaper equivalents that every
+ * backend compiles well: divisions by constants become multiplications by the reciprocal,
+ * constant fractional powers become sqrt/cbrt chains (1/sqrt for negative halves), and
+ * csc/sec/cot factors turn into divisions by sin/cos/tan. Optionally integer powers above the
+ * fused range of the VMs become shortest addition chain multiplications. That is a win for the
+ * native backends, but the VMs evaluate a single ipow instruction faster than the chain. Run it
+ * after Simplify (which would merge the expanded powers again) and right before compilation.
+ */
+template <typename T>
+class StrengthReduction : public Transform<T>
+{
+  using Transform<T>::set;
+  using Transform<T>::apply;
+
+public:
+  /**
+   * With exact set only divisions by powers of two (which have exact reciprocals) are replaced,
+   * with expand_powers set integer powers are replaced by multiplication chains.
+   */
+  StrengthReduction(Function<T> & fb, bool exact = false, bool expand_powers = false);
+
+  void operator()(Node<T> &, SymbolData<T> &) override {}
+
+  void operator()(Node<T> &, UnaryOperatorData<T> &) override;
+  void operator()(Node<T> &, BinaryOperatorData<T> &) override;
+  void operator()(Node<T> &, MultinaryOperatorData<T> &) override;
+
+  void operator()(Node<T> &, UnaryFunctionData<T> &) override;
+  void operator()(Node<T> &, BinaryFunctionData<T> &) override;
+
+  void operator()(Node<T> &, RealNumberData<T> &) override {}
+  void operator()(Node<T> &, RealReferenceData<T> &) override {}
+  void operator()(Node<T> &, RealArrayReferenceData<T> &) override {}
+  void operator()(Node<T> &, LocalVariableData<T> &) override {}
+
+  void operator()(Node<T> &, ConditionalData<T> &) override;
+  void operator()(Node<T> &, IntegerPowerData<T> &) override;
+
+  /// shortest star addition chain for n (optimal for all n < 12509), starting at 1
+  static std::vector<int> additionChain(int n);
+
+protected:
+  /// reduce a child (shared node data is reduced only once)
+  void visit(Node<T> & node);
+
+  /// replace node by base^exponent for a constant exponent
+  void power(Node<T> & node, Node<T> base, Real exponent);
+
+  /// base^exponent as a product of squares and multiplications
+  Node<T> multiplicationChain(Node<T> base, int exponent);
+
+  /// reduced node data for every visited node data (the key is held to keep its address unique)
+  std::unordered_map<const NodeData<T> *, std::pair<NodeDataPtr<T>, NodeDataPtr<T>>> _reduced;
+
+  /// powers of the same base share their chain elements (c^7 + c^11 reuses c^2 and c^4)
+  std::map<std::pair<const NodeData<T> *, int>, Node<T>> _powers;
+
+  const bool _exact;
+  const bool _expand_powers;
+
+  /// the VMs evaluate integer powers up to this exponent with a single instruction
+  static const int _max_fused_exponent = 5;
+};
+
+} // namespace SymbolicMath